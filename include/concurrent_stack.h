@@ -0,0 +1,510 @@
+#pragma once
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "iron_stack.h"
+
+namespace iron_stack {
+
+/*
+ * Hazard pointers shared by all ConcurrentIronStacks: one slot per thread,
+ * retired nodes are freed once no slot points to them. Nodes left by exited
+ * threads are adopted by the next scan.
+ */
+class HazardPointers {
+public:
+    static constexpr int kMaxThreads = 128;
+    static constexpr size_t kScanThreshold = 2 * kMaxThreads;
+
+    using Deleter = void (*)(void*);
+
+    static std::atomic<void*>& Slot() {
+        return Records()[State().slot].hazard;
+    }
+
+    static void Retire(void* pointer, Deleter deleter) {
+        ThreadState& state = State();
+        state.retired.emplace_back(pointer, deleter);
+        if (state.retired.size() >= kScanThreshold) {
+            Scan(&state.retired);
+        }
+    }
+
+private:
+    struct alignas(64) Record {
+        std::atomic<bool> owned;
+        std::atomic<void*> hazard;
+    };
+
+    using RetiredList = std::vector<std::pair<void*, Deleter>>;
+
+    struct ThreadState {
+        ThreadState() : slot(AcquireSlot()) {
+        }
+
+        ~ThreadState() {
+            Records()[slot].hazard.store(nullptr);
+            Scan(&retired);
+            if (!retired.empty()) {
+                std::lock_guard<std::mutex> lock(OrphansMutex());
+                Orphans().insert(Orphans().end(), retired.begin(), retired.end());
+            }
+            Records()[slot].owned.store(false);
+        }
+
+        int slot;
+        RetiredList retired;
+    };
+
+    static Record* Records() {
+        static Record records[kMaxThreads];
+        return records;
+    }
+
+    static ThreadState& State() {
+        thread_local ThreadState state;
+        return state;
+    }
+
+    static std::mutex& OrphansMutex() {
+        static std::mutex mutex;
+        return mutex;
+    }
+
+    static RetiredList& Orphans() {
+        static RetiredList orphans;
+        return orphans;
+    }
+
+    static int AcquireSlot() {
+        for (int slot = 0; slot < kMaxThreads; ++slot) {
+            bool expected = false;
+            if (Records()[slot].owned.compare_exchange_strong(expected, true)) {
+                return slot;
+            }
+        }
+        std::fprintf(GetDumpFile(), "HazardPointers: more than %d threads use concurrent stacks\n", kMaxThreads);
+        Exit();
+        return -1;
+    }
+
+    static void Scan(RetiredList* retired) {
+        {
+            std::lock_guard<std::mutex> lock(OrphansMutex());
+            retired->insert(retired->end(), Orphans().begin(), Orphans().end());
+            Orphans().clear();
+        }
+        std::vector<void*> hazards;
+        for (int slot = 0; slot < kMaxThreads; ++slot) {
+            void* hazard = Records()[slot].hazard.load();
+            if (hazard != nullptr) {
+                hazards.push_back(hazard);
+            }
+        }
+        std::sort(hazards.begin(), hazards.end());
+        RetiredList still_hazardous;
+        for (const auto& node : *retired) {
+            if (std::binary_search(hazards.begin(), hazards.end(), node.first)) {
+                still_hazardous.push_back(node);
+            } else {
+                node.second(node.first);
+            }
+        }
+        retired->swap(still_hazardous);
+    }
+};
+
+/*
+ * Treiber stack with the IronStack checks that survive concurrency: every
+ * node carries its own canaries and a hash of its value and link, checked
+ * whenever a thread reads the node. head_ carries a hash of the object and
+ * the node in the unused top bits of the pointer, checked on every load
+ * before the node is touched. Every operation also checks the object
+ * canaries and that size_ is not negative. Size mismatches are only found
+ * by the full Validate(), since size_ lags the list while operations run.
+ * Nodes are reclaimed with hazard pointers, so a node being checked by one
+ * thread is never freed by another. Validate() and Dump() walk the whole
+ * list and must not race with Push/Pop.
+ */
+template <class T>
+class ConcurrentIronStack : public StackBase {
+public:
+#if PARANOIA_LEVEL >= 1
+    static constexpr int kNodeCanarySize = 4;
+    static constexpr int kHeadTagShift = 48;
+    static constexpr uintptr_t kHeadPointerMask = (static_cast<uintptr_t>(1) << kHeadTagShift) - 1;
+    static_assert(sizeof(uintptr_t) == 8, "head_ tags need 64-bit pointers");
+
+    using NodeCanary = std::array<int, kNodeCanarySize>;
+#endif
+    static constexpr int kMaxBackoffSpins = 1 << 10;
+
+    ConcurrentIronStack() :
+#if PARANOIA_LEVEL >= 1
+        canary_header_(CanaryValue()),
+#endif
+        head_(EncodeHead(nullptr)), size_(0)
+#if PARANOIA_LEVEL >= 1
+        , canary_footer_(CanaryValue())
+#endif
+    {
+#if PARANOIA_LEVEL >= 1
+        if (pointer_manager_.Contains(this)) {
+            Fail("This pointer is already in use (two stacks are constructed at the same address)", nullptr);
+        }
+        pointer_manager_.Add(this);
+#endif
+    }
+
+    ConcurrentIronStack(const ConcurrentIronStack& other) = delete;
+    ConcurrentIronStack(ConcurrentIronStack&& other) = delete;
+    ConcurrentIronStack& operator=(const ConcurrentIronStack& other) = delete;
+    ConcurrentIronStack& operator=(ConcurrentIronStack&& other) = delete;
+
+    ~ConcurrentIronStack() {
+        AssertValid();
+        Node* node = DecodeHead(head_.load());
+        while (node != nullptr) {
+            Node* next = node->next;
+            delete node;
+            node = next;
+        }
+#if PARANOIA_LEVEL >= 1
+        pointer_manager_.Delete(this);
+#endif
+    }
+
+    template <class U>
+    void Push(U&& value) {
+        AssertObject();
+        Node* node = new Node(std::forward<U>(value));
+#if PARANOIA_LEVEL >= 1
+        node->canary_header = NodeCanaryValue(node);
+        node->canary_footer = NodeCanaryValue(node);
+#endif
+        // Counted before it is published, so a Pop of this node never sees size_ below zero
+        size_.fetch_add(1);
+        uintptr_t head = head_.load();
+        int spins = 1;
+        while (true) {
+            node->next = DecodeHead(head);
+#if PARANOIA_LEVEL >= 1
+            node->hash = NodeHashSum(node);
+#endif
+            if (head_.compare_exchange_weak(head, EncodeHead(node))) {
+                break;
+            }
+            Backoff(&spins);
+        }
+    }
+
+    /* Copies the top element into *value (if not null), false when the stack is empty */
+    bool Pop(T* value = nullptr) {
+        AssertObject();
+        std::atomic<void*>& hazard = HazardPointers::Slot();
+        int spins = 1;
+        while (true) {
+            uintptr_t head = 0;
+            Node* node = ProtectHead(&hazard, &head);
+            if (node == nullptr) {
+                hazard.store(nullptr);
+                return false;
+            }
+            AssertNode(node);
+            if (head_.compare_exchange_weak(head, EncodeHead(node->next))) {
+                hazard.store(nullptr);
+                size_.fetch_sub(1);
+                if (value != nullptr) {
+                    // Copy, not move: other threads may still be hashing this node
+                    *value = node->value;
+                }
+                HazardPointers::Retire(node, DeleteNode);
+                return true;
+            }
+            Backoff(&spins);
+        }
+    }
+
+    /* Copies the top element into *value, false when the stack is empty */
+    bool Top(T* value) const {
+        AssertObject();
+        std::atomic<void*>& hazard = HazardPointers::Slot();
+        uintptr_t head = 0;
+        Node* node = ProtectHead(&hazard, &head);
+        if (node != nullptr) {
+            AssertNode(node);
+            *value = node->value;
+        }
+        hazard.store(nullptr);
+        return node != nullptr;
+    }
+
+    bool IsEmpty() const {
+        AssertObject();
+        return DecodeHead(head_.load()) == nullptr;
+    }
+
+    /* Exact only when no Push or Pop is running */
+    int GetSize() const {
+        AssertObject();
+        return size_.load();
+    }
+
+    /* Walks the whole list, call it only while the stack is quiescent */
+    bool Validate(const char** reason = nullptr) const {
+        const char* ignored_reason = "";
+        const char** trusted_reason = TrustedReason(reason, &ignored_reason);
+#if PARANOIA_LEVEL >= 2
+        if (!IsAValidPointer(this)) {
+            *trusted_reason = "BAD_THIS_PTR";
+            return false;
+        }
+#endif
+#if PARANOIA_LEVEL >= 1
+        if (!CanariesAreIntact()) {
+            *trusted_reason = "BAD_CANARY";
+            return false;
+        }
+#endif
+#if PARANOIA_LEVEL >= 1
+        if (!HeadIsValid(head_.load())) {
+            *trusted_reason = "BAD_HEAD";
+            return false;
+        }
+#endif
+        int count = 0;
+        for (Node* node = DecodeHead(head_.load()); node != nullptr; node = node->next) {
+            if (!NodeIsValid(node, trusted_reason)) {
+                return false;
+            }
+            if (++count > size_.load()) {
+                break;
+            }
+        }
+        if (count != size_.load()) {
+            *trusted_reason = "BAD_SIZE";
+            return false;
+        }
+#if PARANOIA_LEVEL >= 1
+        if (!pointer_manager_.Valid()) {
+            *trusted_reason = "BAD_POINTER_MANAGER";
+            return false;
+        }
+#endif
+        *trusted_reason = "OK";
+        return true;
+    }
+
+    void Dump(std::FILE* file) const {
+        DumpWithNode(file, nullptr);
+    }
+
+private:
+    struct Node {
+        template <class U>
+        explicit Node(U&& node_value) : next(nullptr), value(std::forward<U>(node_value)) {
+        }
+
+#if PARANOIA_LEVEL >= 1
+        NodeCanary canary_header;
+        uint32_t hash;
+#endif
+        Node* next;
+        T value;
+#if PARANOIA_LEVEL >= 1
+        NodeCanary canary_footer;
+#endif
+    };
+
+    static void DeleteNode(void* node) {
+        delete static_cast<Node*>(node);
+    }
+
+    static void Backoff(int* spins) {
+        for (int i = 0; i < *spins; ++i) {
+            std::atomic_signal_fence(std::memory_order_seq_cst);
+        }
+        if (*spins < kMaxBackoffSpins) {
+            *spins *= 2;
+        } else {
+            std::this_thread::yield();
+        }
+    }
+
+    /* Publishes the head node in the hazard slot until head_ is stable, so it cannot be freed under us */
+    Node* ProtectHead(std::atomic<void*>* hazard, uintptr_t* head) const {
+        *head = head_.load();
+        while (true) {
+            Node* node = DecodeHead(*head);
+            hazard->store(node);
+            uintptr_t current = head_.load();
+            if (current == *head) {
+                return node;
+            }
+            *head = current;
+        }
+    }
+
+    uintptr_t EncodeHead(const Node* node) const {
+        uintptr_t head = reinterpret_cast<uintptr_t>(node);
+#if PARANOIA_LEVEL >= 1
+        if ((head & ~kHeadPointerMask) != 0) {
+            Fail("BAD_NODE_PTR", nullptr);
+        }
+        head |= static_cast<uintptr_t>(HeadTag(node)) << kHeadTagShift;
+#endif
+        return head;
+    }
+
+    /* Fails on a damaged head_ before anything reads the node it points to */
+    Node* DecodeHead(uintptr_t head) const {
+#if PARANOIA_LEVEL >= 1
+        if (!HeadIsValid(head)) {
+            Fail("BAD_HEAD", nullptr);
+        }
+        head &= kHeadPointerMask;
+#endif
+        return reinterpret_cast<Node*>(head);
+    }
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wunused-parameter"
+    bool NodeIsValid(const Node* node, const char** reason) const {
+#if PARANOIA_LEVEL >= 2
+        if (!IsAValidPointer(static_cast<const void*>(node))) {
+            *reason = "BAD_NODE_PTR";
+            return false;
+        }
+#endif
+#if PARANOIA_LEVEL >= 1
+        const NodeCanary canary = NodeCanaryValue(node);
+        if (!pattern_scan::Equal(node->canary_header.data(), canary.data(), sizeof(NodeCanary)) ||
+                !pattern_scan::Equal(node->canary_footer.data(), canary.data(), sizeof(NodeCanary))) {
+            *reason = "BAD_NODE_CANARY";
+            return false;
+        }
+        if (NodeHashSum(node) != node->hash) {
+            *reason = "BAD_NODE_HASH_SUM";
+            return false;
+        }
+#endif
+        return true;
+    }
+#pragma GCC diagnostic pop
+
+    void AssertNode(const Node* node) const {
+        const char* reason = "OK";
+        if (!NodeIsValid(node, &reason)) {
+            Fail(reason, node);
+        }
+    }
+
+    /* Cheap checks of the object itself, done by every operation */
+    void AssertObject() const {
+#if PARANOIA_LEVEL >= 1
+        if (!CanariesAreIntact()) {
+            Fail("BAD_CANARY", nullptr);
+        }
+#endif
+        if (size_.load() < 0) {
+            Fail("BAD_SIZE", nullptr);
+        }
+    }
+
+    void AssertValid() const {
+#if PARANOIA_LEVEL >= 1
+        const char* reason = "OK";
+        if (!Validate(&reason)) {
+            Fail(reason, nullptr);
+        }
+#endif
+    }
+
+    void Fail(const char* message, const Node* node) const {
+        std::FILE* f = GetDumpFile();
+        std::fprintf(f, "ConcurrentIronStack error, validator message: %s\n", message);
+        DumpWithNode(f, node);
+        Exit();
+    }
+
+    /* Prints the object and one node, the list itself may be changing under us */
+    void DumpWithNode(std::FILE* file, const Node* node) const {
+#if PARANOIA_LEVEL >= 2
+        if (fileno(file) == -1) {
+            return;
+        }
+#endif
+        fprintf(file, "ConcurrentIronStack [%p] {", static_cast<const void*>(this));
+#if PARANOIA_LEVEL >= 1
+        fprintf(file, "\n\tcanaries: %s", CanariesAreIntact() ? "OK" : "DAMAGED");
+#endif
+        fprintf(file, ",\n\thead_: %p", reinterpret_cast<const void*>(head_.load()));
+        fprintf(file, ",\n\tsize_: %d", size_.load());
+        if (node != nullptr && IsAValidPointer(static_cast<const void*>(node))) {
+            fprintf(file, ",\n\tnode [%p] {", static_cast<const void*>(node));
+#if PARANOIA_LEVEL >= 1
+            fprintf(file, "\n\t\tcanary_header: ");
+            DumpObject(file, &node->canary_header);
+            fprintf(file, ",\n\t\thash: 0x%X (expected 0x%X)", node->hash, NodeHashSum(node));
+#endif
+            fprintf(file, ",\n\t\tnext: %p", static_cast<const void*>(node->next));
+            fprintf(file, ",\n\t\tvalue: ");
+            DumpObject(file, &node->value);
+#if PARANOIA_LEVEL >= 1
+            fprintf(file, ",\n\t\tcanary_footer: ");
+            DumpObject(file, &node->canary_footer);
+            fprintf(file, ",\n\t\texpected canary: ");
+            NodeCanary canary = NodeCanaryValue(node);
+            DumpObject(file, &canary);
+#endif
+            fprintf(file, "\n\t}");
+        }
+        fprintf(file, "\n}\n");
+    }
+
+#if PARANOIA_LEVEL >= 1
+    Canary CanaryValue() const {
+        return MakeCanary<kCanarySize>(this);
+    }
+
+    bool CanariesAreIntact() const {
+        const Canary canary = CanaryValue();
+        return pattern_scan::Equal(canary_header_.data(), canary.data(), sizeof(Canary)) &&
+                pattern_scan::Equal(canary_footer_.data(), canary.data(), sizeof(Canary));
+    }
+
+    /* Pointers fit in 48 bits on x86-64, the top 16 bits of head_ hold the tag */
+    uint16_t HeadTag(const Node* node) const {
+        Murmur3 generator(kHashSumSeed);
+        generator << this << node;
+        return static_cast<uint16_t>(generator.GetHashSum());
+    }
+
+    bool HeadIsValid(uintptr_t head) const {
+        return head == EncodeHead(reinterpret_cast<const Node*>(head & kHeadPointerMask));
+    }
+
+    NodeCanary NodeCanaryValue(const Node* node) const {
+        return MakeCanary<kNodeCanarySize>(this, node);
+    }
+
+    uint32_t NodeHashSum(const Node* node) const {
+        Murmur3 generator(kHashSumSeed);
+        generator << this << node << node->next << node->value;
+        return generator.GetHashSum();
+    }
+
+    Canary canary_header_;
+#endif
+    std::atomic<uintptr_t> head_;
+    std::atomic<int> size_;
+#if PARANOIA_LEVEL >= 1
+    Canary canary_footer_;
+#endif
+};
+
+} // namespace iron_stack
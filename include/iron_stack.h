@@ -12,15 +12,43 @@
 #include <cstring>
 #include <vector>
 #include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
 
 #ifndef PARANOIA_LEVEL
 #define PARANOIA_LEVEL 0
 #endif
 
-#if PARANOIA_LEVEL >= 1
-#include "murmur3.h"
+/* Number of last operations kept by every stack for post-mortem dumps, 0 disables the journal */
+#ifndef IRON_STACK_JOURNAL_SIZE
+#define IRON_STACK_JOURNAL_SIZE 0
+#endif
+
+/* Buffers of at least this many bytes go to 2 MB aligned huge-page mappings, 0 keeps everything in malloc */
+#ifndef IRON_STACK_HUGE_PAGE_THRESHOLD
+#define IRON_STACK_HUGE_PAGE_THRESHOLD 0
+#endif
+
+/* Prefer the NUMA node of the thread that grows the stack for huge-page buffers */
+#ifndef IRON_STACK_NUMA_LOCAL
+#define IRON_STACK_NUMA_LOCAL 0
+#endif
+
+#ifdef __linux__
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+
+#if IRON_STACK_JOURNAL_SIZE > 0 && (defined(__x86_64__) || defined(__i386__))
+#include <x86intrin.h>
 #endif
 
+#include "murmur3.h"
+#include "pattern_scan.h"
+#include "validation_pool.h"
+
 #define PM_READ 1
 #define PM_WRITE 2
 #define PM_EXECUTE 4
@@ -81,6 +109,65 @@ static inline bool IsAValidPointer(void* pointer) {
     return pointer != nullptr && CheckPointerRights(pointer, PM_READ | PM_WRITE);
 }
 
+class BufferPlacement {
+public:
+    static constexpr size_t kHugePageSize = 2 << 20;
+
+    /* nullptr when there is no memory, the caller must not fall back to another allocator */
+    static void* Allocate(size_t size, bool huge_pages, bool numa_local) {
+#ifdef __linux__
+        if (huge_pages) {
+            size_t mapped_size = RoundUp(size);
+            uint8_t* raw = reinterpret_cast<uint8_t*>(mmap(nullptr, mapped_size + kHugePageSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+            if (raw == MAP_FAILED) {
+                return nullptr;
+            }
+            uint8_t* aligned = reinterpret_cast<uint8_t*>(RoundUp(reinterpret_cast<uintptr_t>(raw)));
+            if (aligned != raw) {
+                munmap(raw, aligned - raw);
+            }
+            munmap(aligned + mapped_size, raw + kHugePageSize - aligned);
+            madvise(aligned, mapped_size, MADV_HUGEPAGE);
+            if (numa_local) {
+                BindToCurrentNode(aligned, mapped_size);
+            }
+            return aligned;
+        }
+#endif
+        return std::malloc(size);
+    }
+
+    static void Free(void* buffer, size_t size, bool huge_pages) {
+#ifdef __linux__
+        if (huge_pages) {
+            if (buffer != nullptr) {
+                munmap(buffer, RoundUp(size));
+            }
+            return;
+        }
+#endif
+        std::free(buffer);
+    }
+
+private:
+    static size_t RoundUp(size_t value) {
+        return (value + kHugePageSize - 1) & ~(kHugePageSize - 1);
+    }
+
+#ifdef __linux__
+    static void BindToCurrentNode(void* buffer, size_t size) {
+        static constexpr int kMpolPreferred = 1;
+        unsigned cpu = 0, node = 0;
+        if (syscall(SYS_getcpu, &cpu, &node, nullptr) != 0 || node >= sizeof(unsigned long) * 8) {
+            return;
+        }
+        unsigned long node_mask = 1UL << node;
+        // Not fatal: the kernel may be built without NUMA support
+        syscall(SYS_mbind, buffer, size, kMpolPreferred, &node_mask, sizeof(node_mask) * 8, 0);
+    }
+#endif
+};
+
 static std::FILE* GetDumpFile() {
 #if PARANOIA_LEVEL >= 2
     if (fileno(stderr) == -1) {
@@ -262,14 +349,17 @@ class ExternalVerificator {
 };
 #pragma GCC diagnostic pop
 
+/* Stacks of any kind may be created and destroyed on different threads */
 class PointerManager {
     public:
         void Add(const void* pointer) {
+            std::lock_guard<std::mutex> lock(mutex_);
             pointers_.push_back(pointer);
             Update();
         }
 
         void Delete(const void* pointer) {
+            std::lock_guard<std::mutex> lock(mutex_);
             auto iter = std::find(pointers_.begin(), pointers_.end(), pointer);
             if (iter != pointers_.end()) {
                 std::swap(*iter, pointers_.back());
@@ -279,10 +369,12 @@ class PointerManager {
         }
 
         bool Contains(const void* pointer) {
+            std::lock_guard<std::mutex> lock(mutex_);
             return std::find(pointers_.begin(), pointers_.end(), pointer) != pointers_.end();
         }
 
         bool Valid() const {
+            std::lock_guard<std::mutex> lock(mutex_);
             return external_verificator_.CheckBinary("data", pointers_.size() * sizeof(const uint8_t*), reinterpret_cast<const uint8_t*>(pointers_.data()));
         }
 
@@ -292,10 +384,58 @@ class PointerManager {
         }
         std::vector<const void*> pointers_;
         ExternalVerificator external_verificator_;
+        mutable std::mutex mutex_;
+};
+
+/* Algorithm "xor" from p. 4 of Marsaglia, "Xorshift RNGs" */
+class XorshiftRNG {
+public:
+    XorshiftRNG(uint32_t state) : state_(state) {
+    }
+    uint32_t next() {
+        uint32_t return_value = state_;
+        state_ ^= (state_ << 13);
+        state_ ^= (state_ >> 17);
+        state_ ^= (state_ << 5);
+        return return_value;
+    }
+private:
+    uint32_t state_;
 };
 
 class StackBase {
+public:
+#if PARANOIA_LEVEL >= 1
+    static constexpr int kCanarySize = 16;
+    static constexpr int kPoisonValue = 33; // Atomic number of arsenic :-) (0x21)
+    static constexpr int kCanaryRandomSeed = 0x8BADF00D;
+    static constexpr int32_t kHashSumSeed = 0xABADBABE;
+
+    using Canary = std::array<int, kCanarySize>;
+#endif
+
 protected:
+#if PARANOIA_LEVEL >= 1
+    /* Canary of N ints derived from the seeds (usually addresses), shared by all stack kinds */
+    template <int N, class... Seeds>
+    static std::array<int, N> MakeCanary(const Seeds&... seeds) {
+        std::array<int, N> canary;
+        Murmur3 generator(kHashSumSeed);
+        int expand[] = {0, (generator << seeds, 0)...};
+        static_cast<void>(expand);
+        XorshiftRNG rnd(kCanaryRandomSeed ^ generator.GetHashSum());
+        for (int i = 0; i < N; ++i) {
+            canary[i] = rnd.next();
+        }
+        return canary;
+    }
+#endif
+
+    /* Validate writes its verdict to reason if it points to writable memory, to fallback otherwise */
+    static const char** TrustedReason(const char** reason, const char** fallback) {
+        return IsAValidPointer(reason) ? reason : fallback;
+    }
+
     static PointerManager pointer_manager_;
 };
 
@@ -318,22 +458,6 @@ protected:
 #define EVERYTHING_IS_BAD(msg)
 #endif
 
-/* Algorithm "xor" from p. 4 of Marsaglia, "Xorshift RNGs" */
-class XorshiftRNG {
-public:
-    XorshiftRNG(uint32_t state) : state_(state) {
-    }
-    uint32_t next() {
-        uint32_t return_value = state_;
-        state_ ^= (state_ << 13);
-        state_ ^= (state_ >> 17);
-        state_ ^= (state_ << 5);
-        return return_value;
-    }
-private:
-    uint32_t state_;
-};
-
 template <class T>
 int DumpObject(std::FILE* file, const T* object, int object_size = sizeof(T)) {
     int printed_chars = fprintf(file, "0x");
@@ -343,32 +467,91 @@ int DumpObject(std::FILE* file, const T* object, int object_size = sizeof(T)) {
     return printed_chars;
 }
 
+#if IRON_STACK_JOURNAL_SIZE > 0
+/* Ring buffer of the last operations, written after every completed operation and printed by Dump */
+class OperationJournal {
+public:
+    static_assert((IRON_STACK_JOURNAL_SIZE & (IRON_STACK_JOURNAL_SIZE - 1)) == 0, "IRON_STACK_JOURNAL_SIZE must be a power of two");
+    static constexpr uint32_t kCapacity = IRON_STACK_JOURNAL_SIZE;
+
+    enum Opcode : uint8_t {
+        kConstruct,
+        kPush,
+        kPop,
+        kPopEmpty,
+        kResize,
+    };
+
+    struct Entry {
+        uint64_t timestamp;
+        int32_t size;
+        int32_t capacity;
+        uint32_t top_hash;
+        Opcode opcode;
+    };
+
+    OperationJournal() : next_(0) {
+    }
+
+    void Record(Opcode opcode, int size, int capacity, uint32_t top_hash) {
+        Entry& entry = entries_[next_ & (kCapacity - 1)];
+        entry.timestamp = Timestamp();
+        entry.size = size;
+        entry.capacity = capacity;
+        entry.top_hash = top_hash;
+        entry.opcode = opcode;
+        ++next_;
+    }
+
+    void Dump(std::FILE* file, int indent) const {
+        static const char* names[] = {"CONSTRUCT", "PUSH", "POP", "POP_EMPTY", "RESIZE"};
+        fprintf(file, "{ /* %u operations total, oldest first */", next_);
+        uint32_t first = next_ > kCapacity ? next_ - kCapacity : 0;
+        for (uint32_t i = first; i < next_; ++i) {
+            const Entry& entry = entries_[i & (kCapacity - 1)];
+            fputc('\n', file);
+            for (int j = 0; j <= indent; ++j) {
+                fputc('\t', file);
+            }
+            fprintf(file, "#%u %s: size %d, capacity %d, top hash 0x%08X, t %llu,", i,
+                    entry.opcode < sizeof(names) / sizeof(names[0]) ? names[entry.opcode] : "???",
+                    entry.size, entry.capacity, entry.top_hash, static_cast<unsigned long long>(entry.timestamp));
+        }
+        fputc('\n', file);
+        for (int j = 0; j < indent; ++j) {
+            fputc('\t', file);
+        }
+        fputc('}', file);
+    }
+
+private:
+    static uint64_t Timestamp() {
+#if defined(__x86_64__) || defined(__i386__)
+        return __rdtsc();
+#else
+        return std::chrono::steady_clock::now().time_since_epoch().count();
+#endif
+    }
+
+    uint32_t next_;
+    Entry entries_[kCapacity];
+};
+#endif
+
 template <class T>
 class IronStack : public StackBase {
 public:
-#if PARANOIA_LEVEL >= 1
-    static constexpr int kCanarySize = 16;
-    static constexpr int kPoisonValue = 33; // Atomic number of arsenic :-) (0x21)
-    static constexpr int kCanaryRandomSeed = 0x8BADF00D;
-    static constexpr int32_t kHashSumSeed = 0xABADBABE;
-#endif
     static constexpr int kStackExtendRatio = 2;
     static constexpr int kStackShrinkRatio = 4;
     static constexpr int kMinimalStackCapacity = 16;
     static constexpr int kDumpMaxLineLength = 100;
+#if IRON_STACK_JOURNAL_SIZE > 0
+    static constexpr uint32_t kJournalHashSeed = 0x10C0FFEE;
+#endif
 
 #if PARANOIA_LEVEL >= 1
-    using Canary = std::array<int, kCanarySize>;
     Canary CanaryValue() const {
-        Canary canary;
-        Murmur3 generator(kHashSumSeed);
-        generator << this;
-        uint32_t this_hash = generator.GetHashSum();
-        XorshiftRNG rnd(kCanaryRandomSeed ^ this_hash);
-        for (int i = 0; i < kCanarySize; ++i) {
-            canary[i] = rnd.next();
-        }
-        return canary;
+        return MakeCanary<kCanarySize>(this);
     }
 
     void AssertThisIsValid() {
@@ -388,11 +571,15 @@ public:
 #if PARANOIA_LEVEL >= 1
         , hash_sum_(0), canary_footer_(CanaryValue())
 #endif
+        , mutation_count_(0)
         {
             Resize(kMinimalStackCapacity);
 #if PARANOIA_LEVEL >= 1
             pointer_manager_.Add(this);
             RecalcHashSum();
+#endif
+#if IRON_STACK_JOURNAL_SIZE > 0
+            RecordOperation(OperationJournal::kConstruct);
 #endif
     }
 
@@ -405,7 +592,7 @@ public:
         for (int i = 0; i < size_; ++i) {
             buffer_[i].~T();
         }
-        std::free(GetFullBuffer());
+        FreeFullBuffer();
 #if PARANOIA_LEVEL >= 1
         pointer_manager_.Delete(this);
 #endif
@@ -423,9 +610,13 @@ public:
         external_verificator_.SetObject("stack_top", buffer_[size_]);
 #endif
         ++size_;
+        ++mutation_count_;
 #if PARANOIA_LEVEL >= 1
         external_verificator_.SetObject("size", size_);
         RecalcHashSum();
+#endif
+#if IRON_STACK_JOURNAL_SIZE > 0
+        RecordOperation(OperationJournal::kPush);
 #endif
         ASSERT_OK
     }
@@ -441,6 +632,9 @@ public:
     bool Pop() {
         ASSERT_OK
         if (size_ == 0) {
+#if IRON_STACK_JOURNAL_SIZE > 0
+            RecordOperation(OperationJournal::kPopEmpty);
+#endif
             return false;
         }
         --size_;
@@ -451,14 +645,90 @@ public:
         if (capacity_ > kMinimalStackCapacity && kStackShrinkRatio * size_ <= capacity_) {
             Resize(capacity_ / kStackExtendRatio);
         }
+        ++mutation_count_;
 #if PARANOIA_LEVEL >= 1
         external_verificator_.Pop("stack_top");
         external_verificator_.SetObject("size", size_);
         RecalcHashSum();
+#endif
+#if IRON_STACK_JOURNAL_SIZE > 0
+        RecordOperation(OperationJournal::kPop);
 #endif
         ASSERT_OK
         return true;
     }
+
+    /*
+     * Read-only window over the live elements, bottom first. Validated once
+     * when taken; any Push or Pop makes it stale (IsStale() at every level),
+     * and a stale view refuses to be read on PARANOIA_LEVEL >= 1.
+     */
+    class StackView {
+    public:
+        const T* begin() const {
+            AssertFresh();
+            return data_;
+        }
+
+        const T* end() const {
+            AssertFresh();
+            return data_ + size_;
+        }
+
+        const T* data() const {
+            AssertFresh();
+            return data_;
+        }
+
+        const T& operator[](int index) const {
+            AssertFresh();
+#if PARANOIA_LEVEL >= 1
+            if (index < 0 || index >= size_) {
+                stack_->ViewFailure("VIEW_INDEX_OUT_OF_RANGE");
+            }
+#endif
+            return data_[index];
+        }
+
+        int size() const {
+            return size_;
+        }
+
+        bool empty() const {
+            return size_ == 0;
+        }
+
+        bool IsStale() const {
+            return stack_->mutation_count_ != mutation_count_;
+        }
+
+    private:
+        friend class IronStack;
+
+        explicit StackView(const IronStack* stack) :
+            stack_(stack), data_(stack->buffer_), size_(stack->size_), mutation_count_(stack->mutation_count_)
+        {
+        }
+
+        void AssertFresh() const {
+#if PARANOIA_LEVEL >= 1
+            if (IsStale()) {
+                stack_->ViewFailure("STALE_VIEW");
+            }
+#endif
+        }
+
+        const IronStack* stack_;
+        const T* data_;
+        int size_;
+        uint32_t mutation_count_;
+    };
+
+    StackView View() const {
+        ASSERT_OK
+        return StackView(this);
+    }
+
     bool IsEmpty() const {
         ASSERT_OK
         return size_ == 0;
@@ -470,33 +740,48 @@ public:
     }
 
     bool Validate(const char** reason = nullptr) const {
-        const char* empty_string = "";
-        const char** trusted_reason = &empty_string;
-        if (IsAValidPointer(reason)) {
-            trusted_reason = reason;
-        }
+        const char* ignored_reason = "";
+        const char** trusted_reason = TrustedReason(reason, &ignored_reason);
 #if PARANOIA_LEVEL >= 2
         if (!IsAValidPointer(this)) {
             *trusted_reason = "BAD_THIS_PTR";
             return false;
         }
 #endif
+        // Everything below trusts size_ and capacity_ to address the buffer
+        if (size_ < 0 || size_ > capacity_) {
+            *trusted_reason = "BAD_SIZE";
+            return false;
+        }
 #if PARANOIA_LEVEL >= 1
         if (HashSum() != hash_sum_) {
             *trusted_reason = "BAD_HASH_SUM";
             return false;
         }
 
-        if (BufferHashSum() != buffer_hash_sum_) {
-            *trusted_reason = "BAD_BUFFER_HASH_SUM";
+        const Canary canary = CanaryValue();
+        if (!CanaryIsIntact(canary_header_, canary) || !CanaryIsIntact(canary_footer_, canary)) {
+            *trusted_reason = "BAD_CANARY";
             return false;
         }
-#endif
-        if (size_ < 0 || size_ > capacity_) {
-            *trusted_reason = "BAD_SIZE";
+
+        if (buffer_ != nullptr) {
+            if (!CanaryIsIntact(*GetFullBufferCanaryHeader(GetFullBuffer()), canary) ||
+                    !CanaryIsIntact(*GetFullBufferCanaryFooter(GetFullBuffer(), capacity_), canary)) {
+                *trusted_reason = "BAD_BUFFER_CANARY";
+                return false;
+            }
+            if (!pattern_scan::IsFilledWith(buffer_ + size_, sizeof(T) * (capacity_ - size_), kPoisonValue)) {
+                *trusted_reason = "BAD_POISON";
+                return false;
+            }
+        }
+
+        if (BufferHashSum() != buffer_hash_sum_) {
+            *trusted_reason = "BAD_BUFFER_HASH_SUM";
             return false;
         }
-#if PARANOIA_LEVEL >= 1
+
         if (!external_verificator_.CheckObject("size", size_)) {
             *trusted_reason = "BAD_EXTERNAL_SIZE";
             return false;
@@ -567,10 +852,15 @@ public:
 
             fprintf(file, ",\n\thash: 0x%X", hash_sum_);
             fprintf(file, ",\n\tbuffer_hash: 0x%X", buffer_hash_sum_);
+            fprintf(file, ",\n\tmutation_count_: %u", mutation_count_);
 
             fprintf(file, ",\n\tcanary_footer_: ");
             DumpArray(file, canary_footer_.data(), kCanarySize, indent_level);
             ASSERT_CANARY(canary_footer_);
+#endif
+#if IRON_STACK_JOURNAL_SIZE > 0
+            fprintf(file, ",\n\tjournal_: ");
+            journal_.Dump(file, indent_level);
 #endif
         }
         fprintf(file, "\n}\n");
@@ -579,7 +869,10 @@ public:
 private:
     void Resize(int new_capacity) {
         int new_full_size = GetFullBufferSize(new_capacity);
-        uint8_t* new_full_buffer = reinterpret_cast<uint8_t *>(std::malloc(new_full_size));
+        uint8_t* new_full_buffer = reinterpret_cast<uint8_t *>(BufferPlacement::Allocate(new_full_size, UsesHugePages(new_full_size), IRON_STACK_NUMA_LOCAL));
+        if (new_full_buffer == nullptr) {
+            EverythingIsBad("OUT_OF_MEMORY");
+        }
 
         T* new_buffer = GetFullBufferInnerPart(new_full_buffer);
 #if PARANOIA_LEVEL >= 1
@@ -592,7 +885,7 @@ private:
                 new (new_buffer + i) T(std::move(buffer_[i]));
                 buffer_[i].~T();
             }
-            std::free(GetFullBuffer());
+            FreeFullBuffer();
         }
 
         buffer_ = new_buffer;
@@ -601,16 +894,29 @@ private:
 #if PARANOIA_LEVEL >= 1
         *header = CanaryValue();
         *footer = CanaryValue();
+        if (size_ < capacity_) {
+            std::memset(buffer_ + size_, kPoisonValue, sizeof(T) * (capacity_ - size_));
+        }
 
         external_verificator_.SetObject("size", size_);
         external_verificator_.SetObject("capacity", capacity_);
+#endif
+#if IRON_STACK_JOURNAL_SIZE > 0
+        RecordOperation(OperationJournal::kResize);
 #endif
     }
 
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wunused-parameter"
+    void ViewFailure(const char* message) const {
+        EVERYTHING_IS_BAD(message);
+    }
+#pragma GCC diagnostic pop
+
     void EverythingIsBad(const char* msg) const {
         std::FILE* dump = GetDumpFile();
         if (dump != nullptr) {
-            std::fprintf(dump, "IronStack construction ERROR: %s\n", msg);
+            std::fprintf(dump, "IronStack ERROR: %s\n", msg);
         }
         Exit();
     }
@@ -655,7 +961,7 @@ private:
 #if PARANOIA_LEVEL >= 1
     uint32_t HashSum() const {
         Murmur3 generator(kHashSumSeed);
-        generator << CanaryValue() << canary_header_ << size_ << capacity_ << buffer_ << external_verificator_.InternalData() << canary_footer_;
+        generator << CanaryValue() << canary_header_ << size_ << capacity_ << buffer_ << external_verificator_.InternalData() << mutation_count_ << canary_footer_;
         return generator.GetHashSum();
     }
 
@@ -663,16 +969,11 @@ private:
         if (buffer_ == nullptr) {
             return kHashSumSeed;
         }
+        // Canaries and poisoned dead space are compared directly in Validate, only live elements are hashed
         Murmur3 generator(kHashSumSeed);
         generator << CanaryValue();
-        generator << *GetFullBufferCanaryHeader(GetFullBuffer());
-        for (int i = 0; i < size_; ++i) {
-            generator << buffer_[i];
-        }
-        generator.Append(reinterpret_cast<const uint8_t*>(buffer_ + size_), sizeof(T) * (capacity_ - size_));
-        generator << *GetFullBufferCanaryFooter(GetFullBuffer(), capacity_);
+        generator << ChunkedHash::Compute(reinterpret_cast<const uint8_t*>(buffer_), sizeof(T) * size_, kHashSumSeed);
         return generator.GetHashSum();
-
     }
 #endif
 
@@ -684,6 +985,20 @@ private:
 #endif
     }
 
+    static bool UsesHugePages(uint32_t full_size) {
+#if IRON_STACK_HUGE_PAGE_THRESHOLD > 0
+        return full_size >= static_cast<uint32_t>(IRON_STACK_HUGE_PAGE_THRESHOLD);
+#else
+        static_cast<void>(full_size);
+        return false;
+#endif
+    }
+
+    void FreeFullBuffer() const {
+        uint32_t full_size = GetFullBufferSize(capacity_);
+        BufferPlacement::Free(GetFullBuffer(), full_size, UsesHugePages(full_size));
+    }
+
     uint32_t GetFullBufferSize(int capacity) const {
 #if PARANOIA_LEVEL >= 1
         return sizeof(canary_header_) + sizeof(canary_footer_) + capacity * sizeof(T);
@@ -709,12 +1024,28 @@ private:
         return reinterpret_cast<Canary*>(buffer + sizeof(Canary) + capacity * sizeof(T));
     }
 
+    static bool CanaryIsIntact(const Canary& canary, const Canary& expected) {
+        return pattern_scan::Equal(canary.data(), expected.data(), sizeof(Canary));
+    }
+
     void RecalcHashSum() {
         hash_sum_ = HashSum();
         buffer_hash_sum_ = BufferHashSum();
     }
 #endif
 
+#if IRON_STACK_JOURNAL_SIZE > 0
+    void RecordOperation(OperationJournal::Opcode opcode) {
+        uint32_t top_hash = 0;
+        if (size_ > 0) {
+            Murmur3 generator(kJournalHashSeed);
+            generator << buffer_[size_ - 1];
+            top_hash = generator.GetHashSum();
+        }
+        journal_.Record(opcode, size_, capacity_, top_hash);
+    }
+#endif
+
 #if PARANOIA_LEVEL >= 1
     Canary canary_header_;
 #endif
@@ -726,6 +1057,10 @@ private:
     uint32_t hash_sum_;
     uint32_t buffer_hash_sum_;
     Canary canary_footer_;
+#endif
+    uint32_t mutation_count_;
+#if IRON_STACK_JOURNAL_SIZE > 0
+    OperationJournal journal_;
 #endif
 };
 
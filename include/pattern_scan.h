@@ -0,0 +1,148 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define PATTERN_SCAN_X86 1
+#include <immintrin.h>
+#else
+#define PATTERN_SCAN_X86 0
+#endif
+
+/*
+ * Memory-bandwidth checks for poisoned dead space and canaries:
+ * IsFilledWith(data, size, byte) and Equal(lhs, rhs, size).
+ * On x86 the AVX2 or SSE2 kernel is picked once at runtime.
+ */
+namespace pattern_scan {
+
+namespace detail {
+
+using FillCheck = bool (*)(const uint8_t*, size_t, uint8_t);
+using EqualCheck = bool (*)(const uint8_t*, const uint8_t*, size_t);
+
+inline bool IsFilledWithScalar(const uint8_t* data, size_t size, uint8_t value) {
+    for (size_t i = 0; i < size; ++i) {
+        if (data[i] != value) {
+            return false;
+        }
+    }
+    return true;
+}
+
+inline bool EqualScalar(const uint8_t* lhs, const uint8_t* rhs, size_t size) {
+    for (size_t i = 0; i < size; ++i) {
+        if (lhs[i] != rhs[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+#if PATTERN_SCAN_X86
+__attribute__((target("sse2")))
+inline bool IsFilledWithSSE2(const uint8_t* data, size_t size, uint8_t value) {
+    const __m128i pattern = _mm_set1_epi8(static_cast<char>(value));
+    size_t i = 0;
+    for (; i + 64 <= size; i += 64) {
+        __m128i a = _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i)), pattern);
+        __m128i b = _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i + 16)), pattern);
+        __m128i c = _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i + 32)), pattern);
+        __m128i d = _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i + 48)), pattern);
+        if (_mm_movemask_epi8(_mm_and_si128(_mm_and_si128(a, b), _mm_and_si128(c, d))) != 0xFFFF) {
+            return false;
+        }
+    }
+    for (; i + 16 <= size; i += 16) {
+        __m128i a = _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i)), pattern);
+        if (_mm_movemask_epi8(a) != 0xFFFF) {
+            return false;
+        }
+    }
+    return IsFilledWithScalar(data + i, size - i, value);
+}
+
+__attribute__((target("sse2")))
+inline bool EqualSSE2(const uint8_t* lhs, const uint8_t* rhs, size_t size) {
+    size_t i = 0;
+    for (; i + 16 <= size; i += 16) {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(lhs + i));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rhs + i));
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(a, b)) != 0xFFFF) {
+            return false;
+        }
+    }
+    return EqualScalar(lhs + i, rhs + i, size - i);
+}
+
+__attribute__((target("avx2")))
+inline bool IsFilledWithAVX2(const uint8_t* data, size_t size, uint8_t value) {
+    const __m256i pattern = _mm256_set1_epi8(static_cast<char>(value));
+    size_t i = 0;
+    for (; i + 128 <= size; i += 128) {
+        __m256i a = _mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i)), pattern);
+        __m256i b = _mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i + 32)), pattern);
+        __m256i c = _mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i + 64)), pattern);
+        __m256i d = _mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i + 96)), pattern);
+        if (_mm256_movemask_epi8(_mm256_and_si256(_mm256_and_si256(a, b), _mm256_and_si256(c, d))) != -1) {
+            return false;
+        }
+    }
+    for (; i + 32 <= size; i += 32) {
+        __m256i a = _mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i)), pattern);
+        if (_mm256_movemask_epi8(a) != -1) {
+            return false;
+        }
+    }
+    return IsFilledWithSSE2(data + i, size - i, value);
+}
+
+__attribute__((target("avx2")))
+inline bool EqualAVX2(const uint8_t* lhs, const uint8_t* rhs, size_t size) {
+    size_t i = 0;
+    for (; i + 32 <= size; i += 32) {
+        __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(lhs + i));
+        __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(rhs + i));
+        if (_mm256_movemask_epi8(_mm256_cmpeq_epi8(a, b)) != -1) {
+            return false;
+        }
+    }
+    return EqualSSE2(lhs + i, rhs + i, size - i);
+}
+
+inline bool HasAVX2() {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+}
+#endif
+
+inline FillCheck SelectFillCheck() {
+#if PATTERN_SCAN_X86
+    return HasAVX2() ? IsFilledWithAVX2 : IsFilledWithSSE2;
+#else
+    return IsFilledWithScalar;
+#endif
+}
+
+inline EqualCheck SelectEqualCheck() {
+#if PATTERN_SCAN_X86
+    return HasAVX2() ? EqualAVX2 : EqualSSE2;
+#else
+    return EqualScalar;
+#endif
+}
+
+} // namespace detail
+
+inline bool IsFilledWith(const void* data, size_t size, uint8_t value) {
+    static const detail::FillCheck check = detail::SelectFillCheck();
+    return check(reinterpret_cast<const uint8_t*>(data), size, value);
+}
+
+inline bool Equal(const void* lhs, const void* rhs, size_t size) {
+    static const detail::EqualCheck check = detail::SelectEqualCheck();
+    return check(reinterpret_cast<const uint8_t*>(lhs), reinterpret_cast<const uint8_t*>(rhs), size);
+}
+
+} // namespace pattern_scan
@@ -0,0 +1,455 @@
+#pragma once
+
+#include "iron_stack.h"
+
+namespace iron_stack {
+
+/*
+ * Many small stacks behind handles. Per-stack state lives in parallel arrays
+ * (sizes_, capacities_, data_, blocks_, hashes_), elements live in shared
+ * blocks split into power-of-two chunks. Canaries guard blocks, not stacks,
+ * so a million stacks cost a million hashes and a few hundred canaries.
+ * A handle is a slot index plus the slot's 32-bit generation in the upper
+ * half, so Validate() rejects a handle kept after Destroy() even when its
+ * slot has been reused. A slot whose generation is exhausted is retired
+ * instead of wrapping around.
+ */
+template <class T>
+class StackPool : public StackBase {
+public:
+    using Handle = uint64_t;
+
+    static constexpr Handle kInvalidHandle = ~static_cast<Handle>(0);
+    static constexpr int kSlotBits = 32;
+    static constexpr Handle kSlotMask = (static_cast<Handle>(1) << kSlotBits) - 1;
+    static constexpr uint32_t kMaxSlots = 0xFFFFFFFF;
+    static constexpr int kMinimalStackCapacity = 4;
+    static constexpr int kStackExtendRatio = 2;
+    static constexpr int kStackShrinkRatio = 4;
+    static constexpr int kBlockBytes = 64 << 10;
+
+    StackPool() : stack_count_(0) {
+#if PARANOIA_LEVEL >= 1
+        if (pointer_manager_.Contains(this)) {
+            Fail("This pointer is already in use (two pools are constructed at the same address)", kInvalidHandle);
+        }
+        pointer_manager_.Add(this);
+#endif
+    }
+
+    StackPool(const StackPool& other) = delete;
+    StackPool(StackPool&& other) = delete;
+    StackPool& operator=(const StackPool& other) = delete;
+    StackPool& operator=(StackPool&& other) = delete;
+
+    ~StackPool() {
+        AssertPoolOk();
+        for (uint32_t slot = 0; slot < sizes_.size(); ++slot) {
+            if (alive_[slot]) {
+                DestroyElements(slot);
+            }
+        }
+        for (const Block& block : block_list_) {
+            std::free(block.memory);
+        }
+#if PARANOIA_LEVEL >= 1
+        pointer_manager_.Delete(this);
+#endif
+    }
+
+    Handle Create() {
+        uint32_t slot;
+        if (!free_slots_.empty()) {
+            slot = free_slots_.back();
+            free_slots_.pop_back();
+        } else {
+            if (sizes_.size() >= kMaxSlots) {
+                Fail("TOO_MANY_STACKS", kInvalidHandle);
+            }
+            slot = sizes_.size();
+            sizes_.push_back(0);
+            capacities_.push_back(0);
+            data_.push_back(nullptr);
+            blocks_.push_back(0);
+            hashes_.push_back(0);
+            alive_.push_back(false);
+            generations_.push_back(0);
+        }
+        alive_[slot] = true;
+        ++stack_count_;
+        sizes_[slot] = 0;
+        capacities_[slot] = 0;
+        Resize(slot, kMinimalStackCapacity);
+        Handle handle = MakeHandle(slot);
+        AssertStackOk(handle);
+        return handle;
+    }
+
+    void Destroy(Handle handle) {
+        AssertStackOk(handle);
+        uint32_t slot = handle & kSlotMask;
+        DestroyElements(slot);
+        ReleaseChunk(slot);
+        alive_[slot] = false;
+        --stack_count_;
+        data_[slot] = nullptr;
+        if (generations_[slot] != kMaxGeneration) {
+            ++generations_[slot];
+            free_slots_.push_back(slot);
+        }
+    }
+
+    template <class U>
+    void Push(Handle handle, U&& value) {
+        AssertStackOk(handle);
+        uint32_t slot = handle & kSlotMask;
+        if (sizes_[slot] >= capacities_[slot]) {
+            Resize(slot, kStackExtendRatio * capacities_[slot]);
+        }
+        new (data_[slot] + sizes_[slot]) T(std::forward<U>(value));
+        ++sizes_[slot];
+#if PARANOIA_LEVEL >= 1
+        hashes_[slot] = StackHashSum(slot);
+#endif
+        AssertStackOk(handle);
+    }
+
+    const T& Top(Handle handle) const {
+        AssertStackOk(handle);
+        uint32_t slot = handle & kSlotMask;
+        if (sizes_[slot] == 0) {
+            Fail("STACK_IS_EMPTY", handle);
+        }
+        return data_[slot][sizes_[slot] - 1];
+    }
+
+    bool Pop(Handle handle) {
+        AssertStackOk(handle);
+        uint32_t slot = handle & kSlotMask;
+        if (sizes_[slot] == 0) {
+            return false;
+        }
+        int size = --sizes_[slot];
+        data_[slot][size].~T();
+#if PARANOIA_LEVEL >= 1
+        std::memset(data_[slot] + size, kPoisonValue, sizeof(T));
+#endif
+        if (capacities_[slot] > kMinimalStackCapacity && kStackShrinkRatio * size <= capacities_[slot]) {
+            Resize(slot, capacities_[slot] / kStackExtendRatio);
+        }
+#if PARANOIA_LEVEL >= 1
+        hashes_[slot] = StackHashSum(slot);
+#endif
+        AssertStackOk(handle);
+        return true;
+    }
+
+    bool IsEmpty(Handle handle) const {
+        AssertStackOk(handle);
+        return sizes_[handle & kSlotMask] == 0;
+    }
+
+    int GetSize(Handle handle) const {
+        AssertStackOk(handle);
+        return sizes_[handle & kSlotMask];
+    }
+
+    size_t GetStackCount() const {
+        return stack_count_;
+    }
+
+    /* Checks one stack and the block holding its elements */
+    bool Validate(Handle handle, const char** reason = nullptr) const {
+        const char* ignored_reason = "";
+        const char** trusted_reason = TrustedReason(reason, &ignored_reason);
+        uint32_t slot = handle & kSlotMask;
+        if (slot >= sizes_.size() || !alive_[slot] || handle != MakeHandle(slot)) {
+            *trusted_reason = "BAD_HANDLE";
+            return false;
+        }
+#if PARANOIA_LEVEL >= 1
+        if (StackHashSum(slot) != hashes_[slot]) {
+            *trusted_reason = "BAD_HASH_SUM";
+            return false;
+        }
+#endif
+        if (sizes_[slot] < 0 || sizes_[slot] > capacities_[slot]) {
+            *trusted_reason = "BAD_SIZE";
+            return false;
+        }
+#if PARANOIA_LEVEL >= 1
+        if (!BlockCanariesAreIntact(blocks_[slot])) {
+            *trusted_reason = "BAD_BLOCK_CANARY";
+            return false;
+        }
+        int dead_size = capacities_[slot] - sizes_[slot];
+        if (!pattern_scan::IsFilledWith(data_[slot] + sizes_[slot], sizeof(T) * dead_size, kPoisonValue)) {
+            *trusted_reason = "BAD_POISON";
+            return false;
+        }
+#endif
+        *trusted_reason = "OK";
+        return true;
+    }
+
+    /* Checks every stack, every block and every free chunk */
+    bool Validate(const char** reason = nullptr) const {
+        const char* ignored_reason = "";
+        const char** trusted_reason = TrustedReason(reason, &ignored_reason);
+#if PARANOIA_LEVEL >= 2
+        if (!IsAValidPointer(this)) {
+            *trusted_reason = "BAD_THIS_PTR";
+            return false;
+        }
+#endif
+        if (capacities_.size() != sizes_.size() || data_.size() != sizes_.size() || blocks_.size() != sizes_.size() ||
+                hashes_.size() != sizes_.size() || alive_.size() != sizes_.size() || generations_.size() != sizes_.size()) {
+            *trusted_reason = "BAD_ARRAYS";
+            return false;
+        }
+        for (uint32_t slot = 0; slot < sizes_.size(); ++slot) {
+            if (alive_[slot] && !Validate(MakeHandle(slot), trusted_reason)) {
+                return false;
+            }
+        }
+#if PARANOIA_LEVEL >= 1
+        for (uint32_t block = 0; block < block_list_.size(); ++block) {
+            if (!BlockCanariesAreIntact(block)) {
+                *trusted_reason = "BAD_BLOCK_CANARY";
+                return false;
+            }
+        }
+        for (size_t size_class = 0; size_class < free_chunks_.size(); ++size_class) {
+            size_t chunk_bytes = sizeof(T) * (kMinimalStackCapacity << size_class);
+            for (T* chunk : free_chunks_[size_class]) {
+                if (!pattern_scan::IsFilledWith(chunk, chunk_bytes, kPoisonValue)) {
+                    *trusted_reason = "BAD_FREE_CHUNK_POISON";
+                    return false;
+                }
+            }
+        }
+        if (!pointer_manager_.Valid()) {
+            *trusted_reason = "BAD_POINTER_MANAGER";
+            return false;
+        }
+#endif
+        *trusted_reason = "OK";
+        return true;
+    }
+
+    /* Prints one stack and its block, or the pool summary for kInvalidHandle */
+    void Dump(std::FILE* file, Handle handle = kInvalidHandle) const {
+#if PARANOIA_LEVEL >= 2
+        if (fileno(file) == -1) {
+            return;
+        }
+#endif
+        fprintf(file, "StackPool [%p] {", static_cast<const void*>(this));
+        fprintf(file, "\n\tstacks: %zu alive, %zu handles", GetStackCount(), sizes_.size());
+        fprintf(file, ",\n\tblocks: %zu", block_list_.size());
+        uint32_t slot = handle & kSlotMask;
+        if (handle != kInvalidHandle && slot < sizes_.size()) {
+            const char* validator_reason = "OK";
+            bool validator_verdict = Validate(handle, &validator_reason);
+            fprintf(file, ",\n\tstack %u (Validator: %c %s) {", slot, validator_verdict ? '+' : '-', validator_reason);
+            fprintf(file, "\n\t\talive: %d", static_cast<int>(alive_[slot]));
+            fprintf(file, ",\n\t\tgeneration: %u (handle has %u)", generations_[slot], static_cast<uint32_t>(handle >> kSlotBits));
+            fprintf(file, ",\n\t\tsize: %d", sizes_[slot]);
+            fprintf(file, ",\n\t\tcapacity: %d", capacities_[slot]);
+            fprintf(file, ",\n\t\tdata: %p", static_cast<const void*>(data_[slot]));
+            fprintf(file, ",\n\t\tblock: %u", blocks_[slot]);
+            fprintf(file, ",\n\t\thash: 0x%X", hashes_[slot]);
+            if (alive_[slot] && 0 <= sizes_[slot] && sizes_[slot] <= capacities_[slot] && IsAValidPointer(data_[slot])) {
+                fprintf(file, ",\n\t\telements: ");
+                for (int i = 0; i < sizes_[slot]; ++i) {
+                    DumpObject(file, data_[slot] + i);
+                    fprintf(file, ", ");
+                }
+            }
+#if PARANOIA_LEVEL >= 1
+            if (blocks_[slot] < block_list_.size()) {
+                fprintf(file, ",\n\t\tblock canaries: %s", BlockCanariesAreIntact(blocks_[slot]) ? "OK" : "DAMAGED");
+            }
+#endif
+            fprintf(file, "\n\t}");
+        }
+        fprintf(file, "\n}\n");
+    }
+
+private:
+    struct Block {
+        uint8_t* memory;
+        int size_class;
+        int chunk_count;
+    };
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wunused-parameter"
+    void AssertStackOk(Handle handle) const {
+#if PARANOIA_LEVEL >= 1
+        const char* validator_reason = "OK";
+        if (!Validate(handle, &validator_reason)) {
+            Fail(validator_reason, handle);
+        }
+#endif
+    }
+#pragma GCC diagnostic pop
+
+    void AssertPoolOk() const {
+#if PARANOIA_LEVEL >= 1
+        const char* validator_reason = "OK";
+        if (!Validate(&validator_reason)) {
+            Fail(validator_reason, kInvalidHandle);
+        }
+#endif
+    }
+
+    void Fail(const char* message, Handle handle) const {
+        std::FILE* f = GetDumpFile();
+        std::fprintf(f, "StackPool error, validator message: %s\n", message);
+        Dump(f, handle);
+        Exit();
+    }
+
+    static constexpr uint32_t kMaxGeneration = 0xFFFFFFFF;
+
+    Handle MakeHandle(uint32_t slot) const {
+        return slot | (static_cast<Handle>(generations_[slot]) << kSlotBits);
+    }
+
+    static int SizeClass(int capacity) {
+        int size_class = 0;
+        while ((kMinimalStackCapacity << size_class) < capacity) {
+            ++size_class;
+        }
+        return size_class;
+    }
+
+    /* Moves the elements of the stack into a chunk of new_capacity, the old chunk goes back to its free list */
+    void Resize(uint32_t slot, int new_capacity) {
+        T* old_data = data_[slot];
+        uint32_t new_block = 0;
+        T* new_data = AcquireChunk(SizeClass(new_capacity), &new_block);
+        for (int i = 0; i < sizes_[slot]; ++i) {
+            new (new_data + i) T(std::move(old_data[i]));
+            old_data[i].~T();
+        }
+        if (old_data != nullptr) {
+            ReleaseChunk(slot);
+        }
+        data_[slot] = new_data;
+        blocks_[slot] = new_block;
+        capacities_[slot] = new_capacity;
+#if PARANOIA_LEVEL >= 1
+        hashes_[slot] = StackHashSum(slot);
+#endif
+    }
+
+    T* AcquireChunk(int size_class, uint32_t* block) {
+        if (static_cast<size_t>(size_class) >= free_chunks_.size()) {
+            free_chunks_.resize(size_class + 1);
+        }
+        std::vector<T*>& free_list = free_chunks_[size_class];
+        if (free_list.empty()) {
+            AllocateBlock(size_class);
+        }
+        T* chunk = free_list.back();
+        free_list.pop_back();
+        *block = FindBlock(chunk);
+        return chunk;
+    }
+
+    void ReleaseChunk(uint32_t slot) {
+        int size_class = SizeClass(capacities_[slot]);
+#if PARANOIA_LEVEL >= 1
+        std::memset(data_[slot], kPoisonValue, sizeof(T) * capacities_[slot]);
+#endif
+        free_chunks_[size_class].push_back(data_[slot]);
+    }
+
+    void AllocateBlock(int size_class) {
+        size_t chunk_bytes = sizeof(T) * (kMinimalStackCapacity << size_class);
+        int chunk_count = std::max<int>(1, kBlockBytes / chunk_bytes);
+        size_t body_bytes = chunk_bytes * chunk_count;
+        uint8_t* memory = reinterpret_cast<uint8_t*>(std::malloc(CanaryBytes() * 2 + body_bytes));
+        if (memory == nullptr) {
+            Fail("OUT_OF_MEMORY", kInvalidHandle);
+        }
+        T* body = reinterpret_cast<T*>(memory + CanaryBytes());
+        block_list_.push_back(Block{memory, size_class, chunk_count});
+        block_index_.emplace_back(body, static_cast<uint32_t>(block_list_.size() - 1));
+        std::sort(block_index_.begin(), block_index_.end());
+#if PARANOIA_LEVEL >= 1
+        const Canary canary = CanaryValue(block_list_.size() - 1);
+        std::memcpy(memory, canary.data(), sizeof(Canary));
+        std::memset(body, kPoisonValue, body_bytes);
+        std::memcpy(memory + CanaryBytes() + body_bytes, canary.data(), sizeof(Canary));
+#endif
+        std::vector<T*>& free_list = free_chunks_[size_class];
+        for (int chunk = chunk_count - 1; chunk >= 0; --chunk) {
+            free_list.push_back(body + chunk * (kMinimalStackCapacity << size_class));
+        }
+    }
+
+    uint32_t FindBlock(const T* chunk) const {
+        auto iter = std::upper_bound(block_index_.begin(), block_index_.end(), std::make_pair(chunk, UINT32_MAX));
+        return std::prev(iter)->second;
+    }
+
+    static size_t CanaryBytes() {
+#if PARANOIA_LEVEL >= 1
+        return sizeof(Canary);
+#else
+        return 0;
+#endif
+    }
+
+    void DestroyElements(uint32_t slot) {
+        for (int i = 0; i < sizes_[slot]; ++i) {
+            data_[slot][i].~T();
+        }
+        sizes_[slot] = 0;
+    }
+
+#if PARANOIA_LEVEL >= 1
+    Canary CanaryValue(uint32_t block) const {
+        return MakeCanary<kCanarySize>(this, block_list_[block].memory);
+    }
+
+    bool BlockCanariesAreIntact(uint32_t block) const {
+        if (block >= block_list_.size()) {
+            return false;
+        }
+        const Block& info = block_list_[block];
+        size_t body_bytes = sizeof(T) * (kMinimalStackCapacity << info.size_class) * info.chunk_count;
+        const Canary canary = CanaryValue(block);
+        return pattern_scan::Equal(info.memory, canary.data(), sizeof(Canary)) &&
+                pattern_scan::Equal(info.memory + sizeof(Canary) + body_bytes, canary.data(), sizeof(Canary));
+    }
+
+    uint32_t StackHashSum(uint32_t slot) const {
+        Murmur3 generator(kHashSumSeed);
+        generator << this << MakeHandle(slot) << sizes_[slot] << capacities_[slot] << data_[slot] << blocks_[slot];
+        if (0 <= sizes_[slot] && sizes_[slot] <= capacities_[slot]) {
+            generator.Append(reinterpret_cast<const uint8_t*>(data_[slot]), sizeof(T) * sizes_[slot]);
+        }
+        return generator.GetHashSum();
+    }
+#endif
+
+    std::vector<int> sizes_;
+    std::vector<int> capacities_;
+    std::vector<T*> data_;
+    std::vector<uint32_t> blocks_;
+    std::vector<uint32_t> hashes_;
+    std::vector<bool> alive_;
+    std::vector<uint32_t> generations_;
+    std::vector<uint32_t> free_slots_;
+    size_t stack_count_;
+
+    std::vector<Block> block_list_;
+    std::vector<std::pair<const T*, uint32_t>> block_index_;
+    std::vector<std::vector<T*>> free_chunks_;
+};
+
+} // namespace iron_stack
@@ -0,0 +1,205 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+
+#include "murmur3.h"
+
+/* Buffers of at least this many bytes are hashed by the validation pool, smaller ones on the calling thread */
+#ifndef IRON_STACK_PARALLEL_HASH_THRESHOLD
+#define IRON_STACK_PARALLEL_HASH_THRESHOLD (8 << 20)
+#endif
+
+namespace iron_stack {
+
+/*
+ * Worker threads for deep checks of big buffers. Threads are started on the
+ * first parallel job, the caller always takes part in the work. A forked
+ * child has no workers, so it falls back to the calling thread. The pool is
+ * never destroyed: static IronStacks may still validate during exit.
+ */
+class ValidationPool {
+public:
+    static ValidationPool& Instance() {
+        static ValidationPool* pool = new ValidationPool;
+        return *pool;
+    }
+
+    /* 1 disables parallel validation, 0 means one thread per core */
+    void SetThreadCount(int thread_count) {
+        std::lock_guard<std::mutex> job_lock(job_mutex_);
+        StopWorkers();
+        thread_count_ = thread_count > 0 ? thread_count : DefaultThreadCount();
+    }
+
+    int GetThreadCount() const {
+        return thread_count_;
+    }
+
+    void ParallelFor(int count, const std::function<void(int)>& body) {
+        pid_t owner_pid = owner_pid_.load();
+        if (thread_count_ <= 1 || count <= 1 || (owner_pid != 0 && owner_pid != getpid())) {
+            for (int i = 0; i < count; ++i) {
+                body(i);
+            }
+            return;
+        }
+        std::lock_guard<std::mutex> job_lock(job_mutex_);
+        StartWorkers();
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            body_ = &body;
+            count_ = count;
+            next_.store(0);
+            pending_ = count;
+            ++generation_;
+        }
+        wake_.notify_all();
+        RunItems(&body, count);
+        std::unique_lock<std::mutex> lock(mutex_);
+        // Workers still inside RunItems would pick up indices of the next job
+        done_.wait(lock, [this] { return pending_ == 0 && active_ == 0; });
+        body_ = nullptr;
+    }
+
+private:
+    ValidationPool() : thread_count_(DefaultThreadCount()), owner_pid_(0), body_(nullptr), count_(0), pending_(0), active_(0), generation_(0), stop_(false) {
+    }
+
+    static int DefaultThreadCount() {
+        unsigned cores = std::thread::hardware_concurrency();
+        return cores > 0 ? static_cast<int>(cores) : 1;
+    }
+
+    void StartWorkers() {
+        if (!workers_.empty()) {
+            return;
+        }
+        owner_pid_ = getpid();
+        stop_ = false;
+        for (int i = 1; i < thread_count_; ++i) {
+            workers_.emplace_back([this] { WorkerLoop(); });
+        }
+    }
+
+    void StopWorkers() {
+        if (workers_.empty() || owner_pid_ != getpid()) {
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        wake_.notify_all();
+        for (std::thread& worker : workers_) {
+            worker.join();
+        }
+        workers_.clear();
+    }
+
+    void WorkerLoop() {
+        uint64_t seen_generation = 0;
+        while (true) {
+            const std::function<void(int)>* body = nullptr;
+            int count = 0;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                wake_.wait(lock, [&] { return stop_ || generation_ != seen_generation; });
+                if (stop_) {
+                    return;
+                }
+                seen_generation = generation_;
+                if (body_ == nullptr) {
+                    continue;
+                }
+                body = body_;
+                count = count_;
+                ++active_;
+            }
+            RunItems(body, count);
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (--active_ == 0) {
+                done_.notify_all();
+            }
+        }
+    }
+
+    void RunItems(const std::function<void(int)>* body, int count) {
+        int finished = 0;
+        for (int i = next_.fetch_add(1); i < count; i = next_.fetch_add(1)) {
+            (*body)(i);
+            ++finished;
+        }
+        if (finished > 0) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            pending_ -= finished;
+            if (pending_ == 0) {
+                done_.notify_all();
+            }
+        }
+    }
+
+    std::atomic<int> thread_count_;
+    std::atomic<pid_t> owner_pid_;
+    std::vector<std::thread> workers_;
+    std::mutex job_mutex_;
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::condition_variable done_;
+    const std::function<void(int)>* body_;
+    int count_;
+    std::atomic<int> next_;
+    int pending_;
+    int active_;
+    uint64_t generation_;
+    bool stop_;
+};
+
+static inline void SetValidationThreads(int thread_count) {
+    ValidationPool::Instance().SetThreadCount(thread_count);
+}
+
+/*
+ * Murmur3 of every kChunkBytes piece, then Murmur3 of the piece hashes.
+ * The value does not depend on whether the pieces were hashed in parallel.
+ */
+class ChunkedHash {
+public:
+    static constexpr size_t kChunkBytes = 1 << 20;
+
+    static uint32_t Compute(const uint8_t* data, size_t size, uint32_t seed) {
+        int chunk_count = static_cast<int>((size + kChunkBytes - 1) / kChunkBytes);
+        Murmur3 combiner(seed);
+        combiner << size;
+        if (size >= static_cast<size_t>(IRON_STACK_PARALLEL_HASH_THRESHOLD)) {
+            std::vector<uint32_t> chunk_hashes(chunk_count);
+            ValidationPool::Instance().ParallelFor(chunk_count, [&](int i) {
+                chunk_hashes[i] = HashChunk(data, size, seed, i);
+            });
+            combiner.Append(reinterpret_cast<const uint8_t*>(chunk_hashes.data()), chunk_count * sizeof(uint32_t));
+        } else {
+            for (int i = 0; i < chunk_count; ++i) {
+                combiner << HashChunk(data, size, seed, i);
+            }
+        }
+        return combiner.GetHashSum();
+    }
+
+private:
+    static uint32_t HashChunk(const uint8_t* data, size_t size, uint32_t seed, int chunk) {
+        size_t offset = chunk * kChunkBytes;
+        size_t length = size - offset < kChunkBytes ? size - offset : kChunkBytes;
+        Murmur3 generator(seed ^ static_cast<uint32_t>(chunk));
+        generator.Append(data + offset, static_cast<int>(length));
+        return generator.GetHashSum();
+    }
+};
+
+} // namespace iron_stack
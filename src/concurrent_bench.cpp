@@ -0,0 +1,100 @@
+#include "iron_stack.h"
+#include "concurrent_stack.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+ * Contention benchmark: every thread runs Push/Pop pairs on one shared
+ * stack, ConcurrentIronStack against IronStack behind a mutex.
+ * Usage: concurrent_bench [max threads] [operations per thread].
+ */
+
+namespace {
+
+using iron_stack::ConcurrentIronStack;
+using iron_stack::IronStack;
+
+constexpr int kDefaultOpsPerThread = 200000;
+constexpr int kPrefill = 64;
+
+class LockedStack {
+public:
+    void Push(int value) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stack_.Push(value);
+    }
+
+    bool Pop(int* value) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (stack_.IsEmpty()) {
+            return false;
+        }
+        *value = stack_.Top();
+        return stack_.Pop();
+    }
+
+private:
+    std::mutex mutex_;
+    IronStack<int> stack_;
+};
+
+template <class Stack>
+double Run(int threads, int ops_per_thread, long* checksum) {
+    Stack stack;
+    for (int i = 0; i < kPrefill; ++i) {
+        stack.Push(i);
+    }
+    std::vector<long> sums(threads);
+    std::vector<std::thread> workers;
+    auto start = std::chrono::steady_clock::now();
+    for (int t = 0; t < threads; ++t) {
+        workers.emplace_back([&stack, &sums, t, ops_per_thread] {
+            long sum = 0;
+            for (int i = 0; i < ops_per_thread; i += 2) {
+                stack.Push(i);
+                int value = 0;
+                if (stack.Pop(&value)) {
+                    sum += value;
+                }
+            }
+            sums[t] = sum;
+        });
+    }
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    for (long sum : sums) {
+        *checksum += sum;
+    }
+    return static_cast<double>(threads) * ops_per_thread / elapsed.count();
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    int max_threads = argc > 1 ? std::atoi(argv[1]) : static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+    int ops_per_thread = argc > 2 ? std::atoi(argv[2]) : kDefaultOpsPerThread;
+    if (max_threads <= 0 || ops_per_thread <= 0) {
+        std::fprintf(stderr, "Usage: %s [max threads] [operations per thread]\n", argv[0]);
+        return 1;
+    }
+    std::printf("PARANOIA_LEVEL %d, %d operations per thread\n", PARANOIA_LEVEL, ops_per_thread);
+    std::printf("%8s %22s %22s\n", "threads", "concurrent, Mops/s", "mutex, Mops/s");
+    long checksum = 0;
+    for (int threads = 1; ; threads = std::min(threads * 2, max_threads)) {
+        double concurrent = Run<ConcurrentIronStack<int>>(threads, ops_per_thread, &checksum);
+        double locked = Run<LockedStack>(threads, ops_per_thread, &checksum);
+        std::printf("%8d %22.2f %22.2f\n", threads, concurrent / 1e6, locked / 1e6);
+        if (threads == max_threads) {
+            break;
+        }
+    }
+    std::printf("checksum: %ld\n", checksum);
+    return 0;
+}
@@ -0,0 +1,405 @@
+#include "iron_stack.h"
+
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <climits>
+#include <string>
+#include <unistd.h>
+#include <signal.h>
+#include <sys/wait.h>
+
+/*
+ * Corruption-injection harness.
+ *
+ * Runs a randomized Push/Pop workload on IronStack<int>, injects one fault
+ * somewhere in the middle and looks at how the process ends. Each trial runs
+ * in a freshly exec'ed child so that the static PointerManager (and, on
+ * PARANOIA_LEVEL 4, its verificator) is never shared between trials.
+ *
+ * The harness is built once per PARANOIA_LEVEL (corruption_harness_l0 ...
+ * corruption_harness_l4), compare their reports to pick a level. Level 4 needs
+ * ./verificator in the working directory and is slow, pass a smaller number of
+ * trials per fault class as the first argument. Throughput is also reported as
+ * a cost relative to corruption_harness_l0, which must sit next to the binary.
+ */
+
+namespace {
+
+using iron_stack::IronStack;
+using iron_stack::XorshiftRNG;
+using Stack = IronStack<int>;
+
+constexpr int kDefaultTrialsPerFault = 50;
+constexpr int kWarmupOps = 200;
+constexpr int kOpsAfterInjection = 200;
+constexpr int kTrialTimeoutSeconds = 10;
+constexpr int kThroughputOps = 20000;
+constexpr uint32_t kRandomSeed = 0xC0FFEE;
+constexpr int kNotApplicableExitCode = 3;
+
+enum FaultClass {
+    kFaultSize,
+    kFaultCapacity,
+    kFaultCanaryOverrun,
+    kFaultDeadRegion,
+    kFaultBufferSwap,
+    kFaultVerificator,
+    kFaultClassCount
+};
+
+const char* FaultName(int fault) {
+    static const char* names[kFaultClassCount] = {
+        "header size_", "header capacity_", "canary overrun", "dead region write", "buffer_ swap", "verificator state",
+    };
+    return names[fault];
+}
+
+enum Outcome {
+    kOutcomeDetected,
+    kOutcomeCrashed,
+    kOutcomeHung,
+    kOutcomeSilent,
+    kOutcomeNotApplicable,
+    kOutcomeCount
+};
+
+/*
+ * Index of the operation being executed in a trial child. The child reports
+ * the operation it injected the fault before and, on exit, this one.
+ */
+volatile sig_atomic_t g_current_op = -1;
+
+void ReportOp(int op) {
+    char line[32];
+    int length = std::snprintf(line, sizeof(line), "%d\n", op);
+    if (write(STDOUT_FILENO, line, length) != length) {
+        // Nothing sensible to do, parent will treat latency as unknown
+    }
+}
+
+void ReportCurrentOp() {
+    ReportOp(static_cast<int>(g_current_op));
+}
+
+void CrashHandler(int signal_number) {
+    ReportCurrentOp();
+    signal(signal_number, SIG_DFL);
+    raise(signal_number);
+}
+
+/*
+ * Private fields are found the way an attacker would find them: buffer_ is
+ * recovered from &Top(), then located inside the object, size_ and capacity_
+ * are the two ints right before it and the verificator right after it.
+ * buffer_ can only be recovered from a non-empty stack, see ReadyForFault.
+ */
+class StackLayout {
+public:
+    explicit StackLayout(const Stack& stack) : bytes_(reinterpret_cast<uint8_t*>(const_cast<Stack*>(&stack))), buffer_offset_(-1) {
+        int* buffer = const_cast<int*>(&stack.Top()) - (stack.GetSize() - 1);
+        for (size_t offset = 0; offset + sizeof(buffer) <= sizeof(Stack); offset += alignof(int*)) {
+            if (std::memcmp(bytes_ + offset, &buffer, sizeof(buffer)) == 0) {
+                buffer_offset_ = offset;
+                break;
+            }
+        }
+        if (buffer_offset_ < 2 * static_cast<int>(sizeof(int))) {
+            std::fprintf(stderr, "Unable to locate IronStack fields\n");
+            std::exit(2);
+        }
+    }
+
+    int* Size() const {
+        return reinterpret_cast<int*>(bytes_ + buffer_offset_ - 2 * sizeof(int));
+    }
+
+    int* Capacity() const {
+        return reinterpret_cast<int*>(bytes_ + buffer_offset_ - sizeof(int));
+    }
+
+    int** Buffer() const {
+        return reinterpret_cast<int**>(bytes_ + buffer_offset_);
+    }
+
+    /* Everything the verificator keeps besides its own hash, nullptr at PARANOIA_LEVEL 0 */
+    uint8_t* VerificatorState(size_t* size) const {
+#if PARANOIA_LEVEL >= 1
+        uint8_t* verificator = bytes_ + buffer_offset_ + sizeof(int*);
+        const iron_stack::ExternalVerificator* object = reinterpret_cast<const iron_stack::ExternalVerificator*>(verificator);
+        *size = object->InternalSize();
+        return verificator + (object->InternalData() - verificator);
+#else
+        *size = 0;
+        return nullptr;
+#endif
+    }
+
+    size_t CanarySize() const {
+#if PARANOIA_LEVEL >= 1
+        return sizeof(Stack::Canary);
+#else
+        return 0;
+#endif
+    }
+
+private:
+    uint8_t* bytes_;
+    int buffer_offset_;
+};
+
+void RandomOp(Stack* stack, XorshiftRNG* rnd) {
+    uint32_t value = rnd->next();
+    if (value % 100 < 55) {
+        stack->Push(static_cast<int>(value));
+    } else {
+        stack->Pop();
+    }
+}
+
+/* The workload goes on unchanged until the stack has what the fault needs */
+bool ReadyForFault(const Stack& stack, int fault) {
+    if (stack.IsEmpty()) {
+        return false;
+    }
+    StackLayout layout(stack);
+    return fault != kFaultDeadRegion || *layout.Size() < *layout.Capacity();
+}
+
+/* Returns false when the fault class does not apply to this build */
+bool InjectFault(Stack* stack, int fault, XorshiftRNG* rnd) {
+    StackLayout layout(*stack);
+    int* buffer = *layout.Buffer();
+    int size = *layout.Size();
+    int capacity = *layout.Capacity();
+    switch (fault) {
+        case kFaultSize:
+            *layout.Size() = size > 1 ? size - 1 - rnd->next() % size : 0;
+            return true;
+        case kFaultCapacity: {
+            int new_capacity = capacity / 2 + rnd->next() % capacity;
+            *layout.Capacity() = new_capacity != capacity ? new_capacity : capacity + 1;
+            return true;
+        }
+        case kFaultCanaryOverrun:
+            buffer[capacity + rnd->next() % 2] = static_cast<int>(rnd->next());
+            return true;
+        case kFaultDeadRegion:
+            buffer[size + rnd->next() % (capacity - size)] = static_cast<int>(rnd->next());
+            return true;
+        case kFaultBufferSwap: {
+            size_t full_size = layout.CanarySize() * 2 + capacity * sizeof(int);
+            uint8_t* full_buffer = reinterpret_cast<uint8_t*>(buffer) - layout.CanarySize();
+            uint8_t* copy = reinterpret_cast<uint8_t*>(std::malloc(full_size));
+            std::memcpy(copy, full_buffer, full_size);
+            *layout.Buffer() = reinterpret_cast<int*>(copy + layout.CanarySize());
+            return true;
+        }
+        case kFaultVerificator: {
+            size_t state_size = 0;
+            uint8_t* state = layout.VerificatorState(&state_size);
+            if (state == nullptr) {
+                return false;
+            }
+            state[rnd->next() % state_size] ^= 1 + rnd->next() % 255;
+            return true;
+        }
+    }
+    return false;
+}
+
+/* Child side of a trial, never returns */
+void RunTrial(int fault, uint32_t seed, int inject_op) {
+    std::atexit(ReportCurrentOp);
+    for (int signal_number : {SIGSEGV, SIGBUS, SIGFPE, SIGILL, SIGABRT, SIGALRM}) {
+        signal(signal_number, CrashHandler);
+    }
+    alarm(kTrialTimeoutSeconds);
+
+    XorshiftRNG rnd(seed);
+    bool injected = false;
+    int total_ops = INT_MAX;
+    {
+        Stack stack;
+        for (g_current_op = 0; g_current_op < total_ops; ++g_current_op) {
+            if (!injected && g_current_op >= inject_op && ReadyForFault(stack, fault)) {
+                if (!InjectFault(&stack, fault, &rnd)) {
+                    std::_Exit(kNotApplicableExitCode);
+                }
+                ReportOp(static_cast<int>(g_current_op));
+                injected = true;
+                total_ops = g_current_op + kOpsAfterInjection;
+            }
+            RandomOp(&stack, &rnd);
+        }
+        // Destructor is the last chance to notice
+    }
+    std::exit(0);
+}
+
+struct TrialResult {
+    Outcome outcome;
+    int latency;
+};
+
+TrialResult SpawnTrial(int fault, uint32_t seed, int inject_op) {
+    int result_pipe[2];
+    if (pipe(result_pipe) == -1) {
+        perror("pipe");
+        std::exit(2);
+    }
+    pid_t pid = fork();
+    if (pid == -1) {
+        perror("fork");
+        std::exit(2);
+    }
+    if (pid == 0) {
+        // The verificator kills its whole process group when it is tampered with
+        setpgid(0, 0);
+        dup2(result_pipe[1], STDOUT_FILENO);
+        close(result_pipe[0]);
+        close(result_pipe[1]);
+        int dev_null = open("/dev/null", O_WRONLY);
+        dup2(dev_null, STDERR_FILENO);
+        std::string fault_arg = std::to_string(fault);
+        std::string seed_arg = std::to_string(seed);
+        std::string inject_arg = std::to_string(inject_op);
+        execl("/proc/self/exe", "corruption_harness", "--trial", fault_arg.c_str(), seed_arg.c_str(), inject_arg.c_str(), NULL);
+        std::_Exit(127);
+    }
+    close(result_pipe[1]);
+    FILE* child_output = fdopen(result_pipe[0], "r");
+    int injected_op = -1, current_op = -1;
+    bool has_op = std::fscanf(child_output, "%d %d", &injected_op, &current_op) == 2;
+    std::fclose(child_output);
+    int status = 0;
+    waitpid(pid, &status, 0);
+
+    TrialResult result = {kOutcomeSilent, -1};
+    if (WIFEXITED(status)) {
+        if (WEXITSTATUS(status) == kNotApplicableExitCode) {
+            result.outcome = kOutcomeNotApplicable;
+            return result;
+        }
+        if (WEXITSTATUS(status) != 0) {
+            result.outcome = kOutcomeDetected;
+        }
+    } else if (WIFSIGNALED(status)) {
+        switch (WTERMSIG(status)) {
+            case SIGKILL:
+                result.outcome = kOutcomeDetected;
+                break;
+            case SIGALRM:
+                result.outcome = kOutcomeHung;
+                break;
+            default:
+                result.outcome = kOutcomeCrashed;
+        }
+    }
+    if (result.outcome != kOutcomeSilent && has_op && current_op >= injected_op) {
+        result.latency = current_op - injected_op;
+    }
+    return result;
+}
+
+double MeasureThroughput() {
+    XorshiftRNG rnd(kRandomSeed);
+    auto start = std::chrono::steady_clock::now();
+    {
+        Stack stack;
+        for (int i = 0; i < kThroughputOps; ++i) {
+            RandomOp(&stack, &rnd);
+        }
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return kThroughputOps / elapsed.count();
+}
+
+/* Throughput of corruption_harness_l0 from the same directory, 0 if it cannot be run */
+double MeasureBaselineThroughput() {
+    char self[4096];
+    ssize_t length = readlink("/proc/self/exe", self, sizeof(self) - 1);
+    if (length <= 0) {
+        return 0;
+    }
+    std::string path(self, length);
+    path = path.substr(0, path.rfind('/') + 1) + "corruption_harness_l0 --throughput";
+    FILE* baseline = popen(path.c_str(), "r");
+    if (baseline == nullptr) {
+        return 0;
+    }
+    double throughput = 0;
+    if (std::fscanf(baseline, "%lf", &throughput) != 1) {
+        throughput = 0;
+    }
+    pclose(baseline);
+    return throughput;
+}
+
+void RunReport(int trials_per_fault) {
+    std::printf("PARANOIA_LEVEL %d\n", PARANOIA_LEVEL);
+    double throughput = MeasureThroughput();
+    double baseline = PARANOIA_LEVEL == 0 ? throughput : MeasureBaselineThroughput();
+    std::printf("throughput: %.0f ops/s (%d random Push/Pop), ", throughput, kThroughputOps);
+    if (baseline > 0) {
+        std::printf("%.2fx the time of PARANOIA_LEVEL 0\n\n", baseline / throughput);
+    } else {
+        std::printf("corruption_harness_l0 not found, no relative cost\n\n");
+    }
+    std::printf("%-20s %9s %8s %5s %7s %13s %13s\n", "fault", "detected", "crashed", "hung", "silent", "avg latency", "max latency");
+
+    XorshiftRNG rnd(kRandomSeed);
+    for (int fault = 0; fault < kFaultClassCount; ++fault) {
+        int outcomes[kOutcomeCount] = {};
+        int64_t latency_sum = 0;
+        int latency_count = 0;
+        int latency_max = -1;
+        for (int trial = 0; trial < trials_per_fault; ++trial) {
+            uint32_t seed = rnd.next() | 1;
+            int inject_op = kWarmupOps + rnd.next() % kWarmupOps;
+            TrialResult result = SpawnTrial(fault, seed, inject_op);
+            ++outcomes[result.outcome];
+            if (result.outcome == kOutcomeDetected && result.latency >= 0) {
+                latency_sum += result.latency;
+                ++latency_count;
+                latency_max = std::max(latency_max, result.latency);
+            }
+        }
+        if (outcomes[kOutcomeNotApplicable] > 0) {
+            std::printf("%-20s %9s\n", FaultName(fault), "n/a");
+            continue;
+        }
+        std::printf("%-20s %8.0f%% %7.0f%% %4.0f%% %6.0f%% ", FaultName(fault),
+                100.0 * outcomes[kOutcomeDetected] / trials_per_fault,
+                100.0 * outcomes[kOutcomeCrashed] / trials_per_fault,
+                100.0 * outcomes[kOutcomeHung] / trials_per_fault,
+                100.0 * outcomes[kOutcomeSilent] / trials_per_fault);
+        if (latency_count > 0) {
+            std::printf("%10.1f ops %9d ops\n", static_cast<double>(latency_sum) / latency_count, latency_max);
+        } else {
+            std::printf("%13s %13s\n", "-", "-");
+        }
+        std::fflush(stdout);
+    }
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    if (argc == 5 && std::strcmp(argv[1], "--trial") == 0) {
+        RunTrial(std::atoi(argv[2]), std::strtoul(argv[3], nullptr, 10), std::atoi(argv[4]));
+    }
+    if (argc == 2 && std::strcmp(argv[1], "--throughput") == 0) {
+        std::printf("%.0f\n", MeasureThroughput());
+        return 0;
+    }
+    int trials_per_fault = argc > 1 ? std::atoi(argv[1]) : kDefaultTrialsPerFault;
+    if (trials_per_fault <= 0) {
+        std::fprintf(stderr, "Usage: %s [trials per fault class]\n", argv[0]);
+        return 1;
+    }
+    RunReport(trials_per_fault);
+    return 0;
+}
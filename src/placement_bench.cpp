@@ -0,0 +1,108 @@
+#include "iron_stack.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+/*
+ * Buffer placement benchmark.
+ *
+ * Repeats what IronStack does with a large buffer (poisoning, a Validate
+ * scan, a Resize copy) on buffers from malloc, from huge pages and from huge
+ * pages bound to the local NUMA node. Usage: placement_bench [megabytes].
+ */
+
+namespace {
+
+using iron_stack::BufferPlacement;
+
+constexpr int kDefaultMegabytes = 256;
+constexpr int kRepetitions = 3;
+constexpr uint8_t kPoisonValue = 0x21;
+
+struct Placement {
+    const char* name;
+    bool huge_pages;
+    bool numa_local;
+};
+
+struct Timings {
+    double fill;
+    double scan;
+    double resize;
+};
+
+double SecondsSince(std::chrono::steady_clock::time_point start) {
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count();
+}
+
+void* AllocateOrDie(size_t size, const Placement& placement) {
+    void* buffer = BufferPlacement::Allocate(size, placement.huge_pages, placement.numa_local);
+    if (buffer == nullptr) {
+        std::fprintf(stderr, "Unable to allocate %zu bytes (%s)\n", size, placement.name);
+        std::exit(1);
+    }
+    return buffer;
+}
+
+Timings Measure(size_t size, const Placement& placement, uint32_t* checksum) {
+    Timings timings;
+    uint8_t* buffer = reinterpret_cast<uint8_t*>(AllocateOrDie(size, placement));
+
+    auto start = std::chrono::steady_clock::now();
+    std::memset(buffer, kPoisonValue, size);
+    timings.fill = SecondsSince(start);
+
+    start = std::chrono::steady_clock::now();
+    Murmur3 generator(0);
+    generator.Append(buffer, size / 2);
+    bool poisoned = pattern_scan::IsFilledWith(buffer + size / 2, size - size / 2, kPoisonValue);
+    *checksum ^= generator.GetHashSum() ^ poisoned;
+    timings.scan = SecondsSince(start);
+
+    start = std::chrono::steady_clock::now();
+    uint8_t* grown = reinterpret_cast<uint8_t*>(AllocateOrDie(2 * size, placement));
+    std::memcpy(grown, buffer, size);
+    std::memset(grown + size, kPoisonValue, size);
+    BufferPlacement::Free(buffer, size, placement.huge_pages);
+    timings.resize = SecondsSince(start);
+
+    *checksum ^= grown[size - 1];
+    BufferPlacement::Free(grown, 2 * size, placement.huge_pages);
+    return timings;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    int megabytes = argc > 1 ? std::atoi(argv[1]) : kDefaultMegabytes;
+    if (megabytes <= 0) {
+        std::fprintf(stderr, "Usage: %s [megabytes]\n", argv[0]);
+        return 1;
+    }
+    size_t size = static_cast<size_t>(megabytes) << 20;
+
+    const Placement placements[] = {
+        {"malloc", false, false},
+        {"huge pages", true, false},
+        {"huge pages + NUMA", true, true},
+    };
+
+    std::printf("buffer: %d MB, best of %d\n", megabytes, kRepetitions);
+    std::printf("%-20s %12s %12s %12s\n", "placement", "fill, ms", "scan, ms", "resize, ms");
+    uint32_t checksum = 0;
+    for (const Placement& placement : placements) {
+        Timings best = {1e9, 1e9, 1e9};
+        for (int i = 0; i < kRepetitions; ++i) {
+            Timings timings = Measure(size, placement, &checksum);
+            best.fill = std::min(best.fill, timings.fill);
+            best.scan = std::min(best.scan, timings.scan);
+            best.resize = std::min(best.resize, timings.resize);
+        }
+        std::printf("%-20s %12.1f %12.1f %12.1f\n", placement.name, best.fill * 1e3, best.scan * 1e3, best.resize * 1e3);
+    }
+    std::printf("checksum: 0x%08X\n", checksum);
+    return 0;
+}
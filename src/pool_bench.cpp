@@ -0,0 +1,97 @@
+#include "iron_stack.h"
+#include "stack_pool.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <vector>
+
+/*
+ * Many small stacks: separate IronStacks versus one StackPool.
+ * Usage: pool_bench [stacks] [elements per stack].
+ */
+
+namespace {
+
+using iron_stack::IronStack;
+using iron_stack::StackPool;
+
+constexpr int kDefaultStacks = 20000;
+constexpr int kDefaultElements = 3;
+
+long ResidentKilobytes() {
+    long pages = 0, resident = 0;
+    FILE* statm = std::fopen("/proc/self/statm", "r");
+    if (statm == nullptr) {
+        return 0;
+    }
+    if (std::fscanf(statm, "%ld %ld", &pages, &resident) != 2) {
+        resident = 0;
+    }
+    std::fclose(statm);
+    return resident * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+double SecondsSince(std::chrono::steady_clock::time_point start) {
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count();
+}
+
+void Report(const char* name, double seconds, long kilobytes, int stacks) {
+    std::printf("%-12s %10.1f ms %10ld KB %10.1f bytes/stack\n", name, seconds * 1e3, kilobytes, kilobytes * 1024.0 / stacks);
+}
+
+void RunIronStacks(int stacks, int elements) {
+    long resident = ResidentKilobytes();
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::unique_ptr<IronStack<int>>> all;
+    for (int i = 0; i < stacks; ++i) {
+        all.emplace_back(new IronStack<int>());
+        for (int j = 0; j < elements; ++j) {
+            all.back()->Push(i + j);
+        }
+    }
+    long checksum = 0;
+    for (auto& stack : all) {
+        checksum += stack->Top();
+        stack->Pop();
+    }
+    Report("IronStack", SecondsSince(start), ResidentKilobytes() - resident, stacks);
+    std::printf("checksum: %ld\n", checksum);
+}
+
+void RunStackPool(int stacks, int elements) {
+    long resident = ResidentKilobytes();
+    auto start = std::chrono::steady_clock::now();
+    StackPool<int> pool;
+    std::vector<StackPool<int>::Handle> handles;
+    for (int i = 0; i < stacks; ++i) {
+        handles.push_back(pool.Create());
+        for (int j = 0; j < elements; ++j) {
+            pool.Push(handles.back(), i + j);
+        }
+    }
+    long checksum = 0;
+    for (auto handle : handles) {
+        checksum += pool.Top(handle);
+        pool.Pop(handle);
+    }
+    Report("StackPool", SecondsSince(start), ResidentKilobytes() - resident, stacks);
+    std::printf("checksum: %ld\n", checksum);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    int stacks = argc > 1 ? std::atoi(argv[1]) : kDefaultStacks;
+    int elements = argc > 2 ? std::atoi(argv[2]) : kDefaultElements;
+    if (stacks <= 0 || elements < 0) {
+        std::fprintf(stderr, "Usage: %s [stacks] [elements per stack]\n", argv[0]);
+        return 1;
+    }
+    std::printf("PARANOIA_LEVEL %d, %d stacks of %d elements\n", PARANOIA_LEVEL, stacks, elements);
+    RunStackPool(stacks, elements);
+    RunIronStacks(stacks, elements);
+    return 0;
+}
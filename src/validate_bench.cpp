@@ -0,0 +1,63 @@
+#include "iron_stack.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+/*
+ * Deep check scaling: ChunkedHash of a big buffer (what BufferHashSum does
+ * for a big stack) with 1, 2, 4, ... validation threads.
+ * Usage: validate_bench [megabytes] [max threads].
+ */
+
+namespace {
+
+using iron_stack::ChunkedHash;
+using iron_stack::SetValidationThreads;
+
+constexpr int kDefaultMegabytes = 1024;
+constexpr int kRepetitions = 3;
+constexpr uint32_t kSeed = 0xABADBABE;
+
+} // namespace
+
+int main(int argc, char** argv) {
+    int megabytes = argc > 1 ? std::atoi(argv[1]) : kDefaultMegabytes;
+    if (megabytes <= 0 || (argc > 2 && std::atoi(argv[2]) <= 0)) {
+        std::fprintf(stderr, "Usage: %s [megabytes] [max threads]\n", argv[0]);
+        return 1;
+    }
+    size_t size = static_cast<size_t>(megabytes) << 20;
+    std::vector<uint8_t> buffer(size);
+    iron_stack::XorshiftRNG rnd(kSeed);
+    for (size_t i = 0; i < size; i += sizeof(uint32_t)) {
+        uint32_t value = rnd.next();
+        std::memcpy(buffer.data() + i, &value, std::min(sizeof(value), size - i));
+    }
+
+    int cores = argc > 2 ? std::atoi(argv[2]) : static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+    std::printf("buffer: %d MB, best of %d\n", megabytes, kRepetitions);
+    std::printf("%8s %12s %12s %12s\n", "threads", "hash, ms", "GB/s", "hash");
+    uint32_t reference = 0;
+    for (int threads = 1; ; threads = std::min(threads * 2, cores)) {
+        SetValidationThreads(threads);
+        double best = 1e9;
+        uint32_t hash = 0;
+        for (int i = 0; i < kRepetitions; ++i) {
+            auto start = std::chrono::steady_clock::now();
+            hash = ChunkedHash::Compute(buffer.data(), size, kSeed);
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+            best = std::min(best, elapsed.count());
+        }
+        if (threads == 1) {
+            reference = hash;
+        }
+        std::printf("%8d %12.1f %12.2f   0x%08X%s\n", threads, best * 1e3, size / best / 1e9, hash, hash == reference ? "" : " MISMATCH");
+        if (threads == cores) {
+            break;
+        }
+    }
+    return 0;
+}